@@ -13,6 +13,8 @@
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <errno.h>
+#include <signal.h>
+#include <stdint.h>
 
 #define MAXARGS 128
 #define ARGLEN 256
@@ -25,12 +27,28 @@ typedef struct {
     char **argv;     /* NULL-terminated */
     char *infile;    /* input redirection filename or NULL */
     char *outfile;   /* output redirection filename or NULL */
+    char *indup;     /* <&FD: descriptor (after expansion) to use as stdin, or NULL */
+    char *outdup;    /* >&FD: descriptor to use as stdout, or NULL */
+    char *here_body; /* here-document / here-string text fed to stdin, or NULL */
+    int here_expand; /* expand $VAR in here_body (unquoted delimiter) */
+    char *here_delim;    /* <<DELIM seen by the parser, body not read yet */
+    int here_strip_tabs; /* <<-DELIM */
 } cmd_t;
 
-/* Job structure for background processes */
+/* Job structure for background and stopped pipelines */
 typedef struct {
-    pid_t pid;
+    pid_t pid;           /* last stage, used in messages */
+    pid_t pgid;          /* process group of the whole pipeline */
+    pid_t *pids;         /* stage pids, 0 once reaped */
+    unsigned char *pipe_out; /* stage k's stdout is the pipe into stage k+1 */
+    int npids;
+    int live;            /* stages not yet reaped */
+    int stopped;
+    int last_status;     /* wait status of the last stage */
     char *cmdline;
+    uint64_t start_us;   /* trace timestamp at add_job, 0 when not tracing */
+    uint64_t *stage_us;  /* per-stage fork timestamps when tracing, else NULL */
+    char **stage_names;  /* per-stage argv[0] for trace spans, else NULL */
 } job_t;
 
 /* Shell variable (linked list) */
@@ -48,6 +66,9 @@ int parse_pipeline(const char *line, cmd_t **out_cmds, int *out_n);
 void free_pipeline(cmd_t *cmds, int n);
 int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy);
 
+/* Pathname expansion (glob.c) */
+void expand_globs_in_cmds(cmd_t *cmds, int n);
+
 /* Token utilities */
 char **tokenize_whitespace(const char *s, int *count);
 void free_argv(char **argv);
@@ -58,14 +79,37 @@ void add_to_our_history(const char *s);
 void print_history(void);
 char *get_history_command(int n);
 
+/* Input source and replay load-test mode (replay.c) */
+extern int replay_active; /* set by --replay FILE */
+
+char *shell_readline(const char *prompt); /* replay log line or readline() */
+void shell_queue_input(char **lines, int n);
+int shell_queue_end(void);
+int replay_load(const char *path, int repeat);
+void replay_finish(void);
+void replay_at_exit(void);
+
+/* Here-documents (heredoc.c) */
+char *heredoc_read_body(const char *delim, int strip_tabs);
+char *expand_text(const char *text);
+int heredoc_open_fd(const char *body);
+
+/* Coprocesses (coproc.c) */
+int builtin_coproc(char **argv);
+void coproc_reaped(pid_t pid);
+void coproc_close_all(void);
+
 /* Job management */
-void add_job(pid_t pid, const char *cmdline);
+int add_job(pid_t pgid, const pid_t *pids, const unsigned char *pipe_out, int n, const char *cmdline);
+void job_control_child(pid_t pgid, int foreground);
+pid_t job_control_parent(pid_t pid, pid_t pgid);
 void remove_job(pid_t pid);
 void list_jobs(void);
 void reap_finished_jobs(void);
 
 /* Variable management */
 void set_var(const char *name, const char *value);
+void unset_var(const char *name);
 char *get_var(const char *name); /* returns malloc'd string (caller must free) or NULL */
 void print_vars(void);
 int is_assignment_token(const char *token);
@@ -74,6 +118,72 @@ void handle_assignment(const char *assign_str);
 /* Compatibility wrapper */
 void execute_command(char **args); /* convenience wrapper to execute single argv */
 
+/* Latency histograms (stats.c) */
+enum {
+    STAT_PARSE,   /* parse_pipeline */
+    STAT_EXPAND,  /* variable expansion */
+    STAT_SPAWN,   /* pipe + fork of all stages */
+    STAT_WAIT,    /* last fork to first child reaped */
+    STAT_REAP,    /* first child reaped to last */
+    STAT_NPHASES
+};
+
+extern int stats_enabled; /* set by --stats or 'stats on' */
+
+uint64_t stats_now(void);                   /* 0 when disabled */
+void stats_record(int phase, uint64_t start_ns);
+void stats_reset(void);
+void stats_print(int json);
+int builtin_stats(char **argv);
+
+/* Chrome trace-event export (trace.c) */
+extern int trace_enabled; /* set by --trace FILE */
+
+int trace_open(const char *path);
+void trace_close(void);
+uint64_t trace_now(void);                   /* microseconds, 0 when disabled */
+/* emit a span from start_us to now; tid 0 is the shell's own track */
+void trace_span(const char *name, const char *cat, uint64_t start_us, int tid, const char *detail);
+
+/* Allocation statistics (alloc.c) */
+typedef struct {
+    size_t allocs;        /* malloc/calloc/realloc/strdup calls */
+    size_t frees;
+    size_t bytes;         /* cumulative bytes handed out */
+    size_t live_objects;
+    size_t live_bytes;
+    size_t peak_bytes;
+} alloc_counters_t;
+
+extern int alloc_stats_enabled; /* set by --alloc-stats */
+
+void *sh_malloc(size_t n);
+void *sh_calloc(size_t n, size_t sz);
+void *sh_realloc(void *p, size_t n);
+char *sh_strdup(const char *s);
+char *sh_strndup(const char *s, size_t n);
+void sh_free(void *p);
+char *sh_readline(const char *prompt);
+void alloc_get_counters(alloc_counters_t *out);
+void alloc_line_begin(void);
+void alloc_line_report(const char *line);
+void alloc_stats_enable(void);
+void alloc_final_report(void);
+
+/* Built with ALLOC_STATS=1: route the shell's own allocations through the
+   counting wrappers. alloc.c defines SHELL_ALLOC_IMPL to see the real ones. */
+#if defined(SHELL_ALLOC_STATS) && !defined(SHELL_ALLOC_IMPL)
+#undef strdup
+#undef strndup
+#define malloc(n) sh_malloc(n)
+#define calloc(n, sz) sh_calloc(n, sz)
+#define realloc(p, n) sh_realloc(p, n)
+#define strdup(s) sh_strdup(s)
+#define strndup(s, n) sh_strndup(s, n)
+#define free(p) sh_free(p)
+#define readline(prompt) sh_readline(prompt)
+#endif
+
 #endif
 
 
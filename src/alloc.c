@@ -0,0 +1,116 @@
+/* alloc.c: counting allocator used when built with ALLOC_STATS=1.
+   shell.h redirects malloc/calloc/realloc/strdup/strndup/free to the
+   sh_* wrappers below; this file is compiled with SHELL_ALLOC_IMPL so it
+   sees the real libc functions. */
+#define SHELL_ALLOC_IMPL
+#include "shell.h"
+#include <malloc.h>
+
+int alloc_stats_enabled = 0;
+
+static pid_t alloc_owner = 0;
+static alloc_counters_t totals;
+static alloc_counters_t line_start;
+
+static void note_alloc(void *p) {
+    if (!p) return;
+    size_t sz = malloc_usable_size(p);
+    totals.allocs++;
+    totals.bytes += sz;
+    totals.live_objects++;
+    totals.live_bytes += sz;
+    if (totals.live_bytes > totals.peak_bytes) totals.peak_bytes = totals.live_bytes;
+}
+
+static void note_free(void *p) {
+    if (!p) return;
+    size_t sz = malloc_usable_size(p);
+    totals.frees++;
+    totals.live_objects--;
+    totals.live_bytes -= sz;
+}
+
+void *sh_malloc(size_t n) {
+    void *p = malloc(n);
+    note_alloc(p);
+    return p;
+}
+
+void *sh_calloc(size_t n, size_t sz) {
+    void *p = calloc(n, sz);
+    note_alloc(p);
+    return p;
+}
+
+void *sh_realloc(void *old, size_t n) {
+    size_t old_sz = old ? malloc_usable_size(old) : 0;
+    void *p = realloc(old, n);
+    if (!p) return NULL;
+    if (!old) { note_alloc(p); return p; }
+    /* a resize counts as one allocation of the new block, not a new object */
+    size_t sz = malloc_usable_size(p);
+    totals.allocs++;
+    totals.bytes += sz;
+    totals.live_bytes += sz - old_sz;
+    if (totals.live_bytes > totals.peak_bytes) totals.peak_bytes = totals.live_bytes;
+    return p;
+}
+
+char *sh_strdup(const char *s) {
+    char *p = strdup(s);
+    note_alloc(p);
+    return p;
+}
+
+char *sh_strndup(const char *s, size_t n) {
+    char *p = strndup(s, n);
+    note_alloc(p);
+    return p;
+}
+
+void sh_free(void *p) {
+    note_free(p);
+    free(p);
+}
+
+/* readline() allocates with libc malloc; adopt its result so the
+   matching free() in the shell balances out */
+char *sh_readline(const char *prompt) {
+    char *p = readline(prompt);
+    note_alloc(p);
+    return p;
+}
+
+void alloc_get_counters(alloc_counters_t *out) {
+    if (out) *out = totals;
+}
+
+void alloc_line_begin(void) {
+    line_start = totals;
+}
+
+void alloc_line_report(const char *line) {
+    if (!alloc_stats_enabled) return;
+    fprintf(stderr, "[alloc] allocs=%zu frees=%zu bytes=%zu live=%+ld (%zu objs, %zu bytes): %s\n",
+            totals.allocs - line_start.allocs,
+            totals.frees - line_start.frees,
+            totals.bytes - line_start.bytes,
+            (long)totals.live_objects - (long)line_start.live_objects,
+            totals.live_objects, totals.live_bytes,
+            line ? line : "");
+}
+
+/* --alloc-stats: the total is printed from atexit so the 'exit' builtin
+   reports too; forked children inherit the handler, hence the owner check */
+void alloc_stats_enable(void) {
+    alloc_stats_enabled = 1;
+    alloc_owner = getpid();
+    atexit(alloc_final_report);
+}
+
+void alloc_final_report(void) {
+    if (!alloc_stats_enabled || getpid() != alloc_owner) return;
+    fprintf(stderr, "[alloc] total: allocs=%zu frees=%zu bytes=%zu live=%zu objs/%zu bytes peak=%zu bytes\n",
+            totals.allocs, totals.frees, totals.bytes,
+            totals.live_objects, totals.live_bytes, totals.peak_bytes);
+}
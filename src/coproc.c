@@ -0,0 +1,136 @@
+/* coproc.c: long-lived worker processes connected by two pipes.
+   `coproc NAME cmd args...` starts cmd once and sets NAME_IN (write end,
+   feeds its stdin) and NAME_OUT (read end, its stdout). Scripts then talk
+   to it with `cmd >&$NAME_IN` and `read -u $NAME_OUT var` instead of
+   starting a new process per query. */
+#include "shell.h"
+
+#define COPROCS_MAX 16
+
+typedef struct {
+    char *name;
+    pid_t pid;
+    int in_fd;   /* shell writes here -> coproc stdin, -1 once closed */
+    int out_fd;  /* coproc stdout -> shell reads here */
+} coproc_t;
+
+static coproc_t coprocs[COPROCS_MAX];
+static int coprocs_count = 0;
+
+static coproc_t *find_coproc(const char *name) {
+    for (int i = 0; i < coprocs_count; ++i)
+        if (strcmp(coprocs[i].name, name) == 0) return &coprocs[i];
+    return NULL;
+}
+
+static void set_fd_var(const char *name, const char *suffix, int fd) {
+    char var[ARGLEN];
+    char val[16];
+    snprintf(var, sizeof(var), "%s_%s", name, suffix);
+    snprintf(val, sizeof(val), "%d", fd);
+    set_var(var, val);
+}
+
+static void unset_fd_var(const char *name, const char *suffix) {
+    char var[ARGLEN];
+    snprintf(var, sizeof(var), "%s_%s", name, suffix);
+    unset_var(var);
+}
+
+/* NAME_IN goes away with the descriptor so a later >&$NAME_IN cannot
+   write to whatever file reuses that number */
+static void close_coproc_input(coproc_t *c) {
+    if (c->in_fd >= 0) {
+        close(c->in_fd);
+        unset_fd_var(c->name, "IN");
+    }
+    c->in_fd = -1;
+}
+
+/* coproc NAME cmd [args...]  |  coproc -c NAME (close its input) */
+int builtin_coproc(char **argv) {
+    if (argv[1] && strcmp(argv[1], "-c") == 0) {
+        coproc_t *c = argv[2] ? find_coproc(argv[2]) : NULL;
+        if (!c) { fprintf(stderr, "coproc: no such coprocess: %s\n", argv[2] ? argv[2] : ""); return 1; }
+        close_coproc_input(c);
+        return 0;
+    }
+    if (!argv[1] || !argv[2]) {
+        fprintf(stderr, "coproc: usage: coproc NAME command [args...]\n");
+        return 1;
+    }
+    const char *name = argv[1];
+    if (find_coproc(name)) {
+        fprintf(stderr, "coproc: %s is already running\n", name);
+        return 1;
+    }
+    if (coprocs_count >= COPROCS_MAX) {
+        fprintf(stderr, "coproc: too many coprocesses\n");
+        return 1;
+    }
+
+    int to_child[2], from_child[2];
+    if (pipe2(to_child, O_CLOEXEC) < 0) { perror("pipe"); return 1; }
+    if (pipe2(from_child, O_CLOEXEC) < 0) {
+        perror("pipe");
+        close(to_child[0]); close(to_child[1]);
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(to_child[0]); close(to_child[1]);
+        close(from_child[0]); close(from_child[1]);
+        return 1;
+    } else if (pid == 0) {
+        job_control_child(0, 0);
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        execvp(argv[2], argv + 2);
+        perror("execvp");
+        exit(1);
+    }
+
+    pid_t pg = job_control_parent(pid, 0);
+    close(to_child[0]);
+    close(from_child[1]);
+
+    coproc_t *c = &coprocs[coprocs_count++];
+    c->name = strdup(name);
+    c->pid = pid;
+    c->in_fd = to_child[1];
+    c->out_fd = from_child[0];
+    set_fd_var(name, "IN", c->in_fd);
+    set_fd_var(name, "OUT", c->out_fd);
+
+    char desc[ARGLEN];
+    snprintf(desc, sizeof(desc), "coproc %s: %s", name, argv[2]);
+    add_job(pg, &pid, NULL, 1, desc);
+    printf("[bg] started pid %d: %s\n", pid, desc);
+    return 0;
+}
+
+/* called when a job is reaped: release the coprocess's descriptors */
+void coproc_reaped(pid_t pid) {
+    for (int i = 0; i < coprocs_count; ++i) {
+        if (coprocs[i].pid != pid) continue;
+        close_coproc_input(&coprocs[i]);
+        close(coprocs[i].out_fd);
+        unset_fd_var(coprocs[i].name, "OUT");
+        free(coprocs[i].name);
+        for (int j = i + 1; j < coprocs_count; ++j) coprocs[j-1] = coprocs[j];
+        coprocs_count--;
+        return;
+    }
+}
+
+/* at shell exit: close every coprocess's input so it can see EOF */
+void coproc_close_all(void) {
+    for (int i = 0; i < coprocs_count; ++i) {
+        close_coproc_input(&coprocs[i]);
+        close(coprocs[i].out_fd);
+        free(coprocs[i].name);
+    }
+    coprocs_count = 0;
+}
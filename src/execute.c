@@ -7,6 +7,12 @@ void execute_command(char **args) {
     single.argv = args;
     single.infile = NULL;
     single.outfile = NULL;
+    single.indup = NULL;
+    single.outdup = NULL;
+    single.here_body = NULL;
+    single.here_expand = 0;
+    single.here_delim = NULL;
+    single.here_strip_tabs = 0;
     /* use execute_pipeline for single command, foreground */
     execute_pipeline(&single, 1, 0, NULL);
 }
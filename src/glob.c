@@ -0,0 +1,241 @@
+/* glob.c: pathname expansion of *, ? and [...] in argv words.
+   Directories are read with batched getdents64 calls and kept in a cache
+   that lives for one pipeline, so `*.log *.gz` lists the directory once;
+   it is not kept longer, since `touch x.log; ls *.log` must see x.log. Literal leading path components are never scanned, and each
+   pattern component's literal prefix rejects names before fnmatch runs. */
+#include "shell.h"
+#include <fnmatch.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define GETDENTS_BUFSZ (64 * 1024)
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct {
+    char *path;          /* directory as passed to open(), "." for cwd */
+    char **names;
+    unsigned char *types;
+    int count;           /* -1 if the directory could not be read */
+} dir_listing_t;
+
+/* listings are allocated individually so pointers stay valid while the
+   cache grows; slots is an open-addressing hash of indices into dirs */
+typedef struct {
+    dir_listing_t **dirs;
+    int n, cap;
+    int *slots;          /* -1 = empty; size nslots, a power of two */
+    int nslots;
+} dir_cache_t;
+
+typedef struct {
+    char **v;
+    int n, cap;
+} strvec_t;
+
+static void strvec_push(strvec_t *sv, char *s) {
+    if (sv->n + 1 >= sv->cap) {
+        sv->cap = sv->cap ? sv->cap * 2 : 16;
+        sv->v = realloc(sv->v, sizeof(char*) * sv->cap);
+    }
+    sv->v[sv->n++] = s;
+}
+
+static int has_glob_meta(const char *s, size_t len) {
+    for (size_t i = 0; i < len; ++i)
+        if (s[i] == '*' || s[i] == '?' || s[i] == '[') return 1;
+    return 0;
+}
+
+/* read a whole directory with getdents64; "." and ".." are skipped */
+static void read_listing(dir_listing_t *d) {
+    d->names = NULL;
+    d->types = NULL;
+    d->count = -1;
+    int fd = open(d->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    char *buf = malloc(GETDENTS_BUFSZ);
+    int cap = 64;
+    d->names = malloc(sizeof(char*) * cap);
+    d->types = malloc(cap);
+    d->count = 0;
+    long nread;
+    while ((nread = syscall(SYS_getdents64, fd, buf, GETDENTS_BUFSZ)) > 0) {
+        for (long off = 0; off < nread; ) {
+            struct linux_dirent64 *e = (struct linux_dirent64 *)(buf + off);
+            off += e->d_reclen;
+            if (e->d_name[0] == '.' &&
+                (e->d_name[1] == '\0' || (e->d_name[1] == '.' && e->d_name[2] == '\0')))
+                continue;
+            if (d->count >= cap) {
+                cap *= 2;
+                d->names = realloc(d->names, sizeof(char*) * cap);
+                d->types = realloc(d->types, cap);
+            }
+            d->names[d->count] = strdup(e->d_name);
+            d->types[d->count] = e->d_type;
+            d->count++;
+        }
+    }
+    free(buf);
+    close(fd);
+}
+
+static unsigned hash_path(const char *s) {
+    unsigned h = 2166136261u; /* FNV-1a */
+    for (; *s; ++s) h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+static void cache_rehash(dir_cache_t *c, int nslots) {
+    free(c->slots);
+    c->slots = malloc(sizeof(int) * nslots);
+    c->nslots = nslots;
+    for (int i = 0; i < nslots; ++i) c->slots[i] = -1;
+    for (int i = 0; i < c->n; ++i) {
+        unsigned h = hash_path(c->dirs[i]->path) & (nslots - 1);
+        while (c->slots[h] >= 0) h = (h + 1) & (nslots - 1);
+        c->slots[h] = i;
+    }
+}
+
+static dir_listing_t *cache_get(dir_cache_t *c, const char *path) {
+    if (c->nslots == 0) cache_rehash(c, 16);
+    unsigned h = hash_path(path) & (c->nslots - 1);
+    for (; c->slots[h] >= 0; h = (h + 1) & (c->nslots - 1))
+        if (strcmp(c->dirs[c->slots[h]]->path, path) == 0) return c->dirs[c->slots[h]];
+
+    if (c->n >= c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 4;
+        c->dirs = realloc(c->dirs, sizeof(dir_listing_t*) * c->cap);
+    }
+    dir_listing_t *d = malloc(sizeof(dir_listing_t));
+    d->path = strdup(path);
+    read_listing(d);
+    c->dirs[c->n] = d;
+    c->slots[h] = c->n++;
+    if (c->n * 2 > c->nslots) cache_rehash(c, c->nslots * 2);
+    return d;
+}
+
+static void cache_free(dir_cache_t *c) {
+    for (int i = 0; i < c->n; ++i) {
+        dir_listing_t *d = c->dirs[i];
+        for (int j = 0; j < d->count; ++j) free(d->names[j]);
+        free(d->names);
+        free(d->types);
+        free(d->path);
+        free(d);
+    }
+    free(c->dirs);
+    free(c->slots);
+}
+
+static int is_dir_entry(const char *path, unsigned char type) {
+    if (type == DT_DIR) return 1;
+    if (type != DT_LNK && type != DT_UNKNOWN) return 0;
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/* join "prefix" and "name" ("" prefix means relative to cwd) */
+static char *path_join(const char *prefix, const char *name, size_t namelen) {
+    size_t pl = strlen(prefix);
+    int sep = pl > 0 && prefix[pl-1] != '/';
+    char *r = malloc(pl + sep + namelen + 1);
+    memcpy(r, prefix, pl);
+    if (sep) r[pl] = '/';
+    memcpy(r + pl + sep, name, namelen);
+    r[pl + sep + namelen] = '\0';
+    return r;
+}
+
+/* match path components of pat (starting at pat, no leading '/') under
+   prefix, appending full matches to out */
+static void glob_walk(dir_cache_t *cache, const char *prefix, const char *pat, strvec_t *out) {
+    const char *slash = strchr(pat, '/');
+    size_t clen = slash ? (size_t)(slash - pat) : strlen(pat);
+    const char *rest = slash ? slash + 1 : NULL;
+    while (rest && *rest == '/') ++rest;
+
+    if (clen == 0) { /* trailing slash: "dir/" */
+        strvec_push(out, strdup(prefix));
+        return;
+    }
+
+    if (!has_glob_meta(pat, clen)) {
+        char *next = path_join(prefix, pat, clen);
+        if (rest && *rest) glob_walk(cache, next, rest, out);
+        else if (access(next, F_OK) == 0) { strvec_push(out, next); return; }
+        free(next);
+        return;
+    }
+
+    char *comp = strndup(pat, clen);
+    size_t litlen = strcspn(comp, "*?[");
+    dir_listing_t *d = cache_get(cache, *prefix ? prefix : ".");
+    for (int i = 0; i < d->count; ++i) {
+        const char *name = d->names[i];
+        if (strncmp(name, comp, litlen) != 0) continue;
+        if (fnmatch(comp, name, FNM_PERIOD) != 0) continue;
+        char *next = path_join(prefix, name, strlen(name));
+        if (rest) {
+            if (is_dir_entry(next, d->types[i])) {
+                if (*rest) glob_walk(cache, next, rest, out);
+                else { char *withslash = path_join(next, "", 0); strvec_push(out, withslash); }
+            }
+            free(next);
+        } else {
+            strvec_push(out, next);
+        }
+    }
+    free(comp);
+}
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* expand_globs_in_cmds: replace each argv word containing glob characters
+   with its sorted matches; words with no match are left as typed. */
+void expand_globs_in_cmds(cmd_t *cmds, int n) {
+    dir_cache_t cache = {0};
+    for (int i = 0; i < n; ++i) {
+        char **argv = cmds[i].argv;
+        if (!argv) continue;
+        int any = 0;
+        for (int j = 0; argv[j] && !any; ++j) any = has_glob_meta(argv[j], strlen(argv[j]));
+        if (!any) continue;
+
+        strvec_t nargv = {0};
+        for (int j = 0; argv[j]; ++j) {
+            char *w = argv[j];
+            if (!has_glob_meta(w, strlen(w))) { strvec_push(&nargv, w); continue; }
+            strvec_t matches = {0};
+            if (w[0] == '/') {
+                const char *p = w;
+                while (*p == '/') ++p;
+                glob_walk(&cache, "/", p, &matches);
+            } else {
+                glob_walk(&cache, "", w, &matches);
+            }
+            if (matches.n == 0) { strvec_push(&nargv, w); continue; }
+            qsort(matches.v, matches.n, sizeof(char*), cmp_str);
+            for (int k = 0; k < matches.n; ++k) strvec_push(&nargv, matches.v[k]);
+            free(matches.v);
+            free(w);
+        }
+        strvec_push(&nargv, NULL);
+        free(argv);
+        cmds[i].argv = nargv.v;
+    }
+    cache_free(&cache);
+}
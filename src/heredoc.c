@@ -0,0 +1,119 @@
+/* heredoc.c: here-documents (<<DELIM, <<-DELIM) and here-strings (<<<word).
+   The body is collected at parse time and handed to the stage as stdin via
+   a pipe the shell fills before forking. A body that does not fit in the
+   pipe, even after growing it with F_SETPIPE_SZ, goes into an unlinked
+   memfd instead, so the shell never blocks and never touches the disk. */
+#include "shell.h"
+#include <sys/mman.h>
+
+/* read lines until one equals delim; strip_tabs implements <<- */
+char *heredoc_read_body(const char *delim, int strip_tabs) {
+    size_t cap = 256, len = 0;
+    char *body = malloc(cap);
+    body[0] = '\0';
+    while (1) {
+        char *line = shell_readline("> ");
+        if (!line) {
+            fprintf(stderr, "warning: here-document delimited by end-of-file (wanted '%s')\n", delim);
+            break;
+        }
+        char *p = line;
+        if (strip_tabs) while (*p == '\t') ++p;
+        if (strcmp(p, delim) == 0) { free(line); break; }
+        size_t l = strlen(p);
+        if (len + l + 2 > cap) {
+            while (len + l + 2 > cap) cap *= 2;
+            body = realloc(body, cap);
+        }
+        memcpy(body + len, p, l);
+        len += l;
+        body[len++] = '\n';
+        body[len] = '\0';
+        free(line);
+    }
+    return body;
+}
+
+static int is_name_char(char c, int first) {
+    return c == '_' || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+           (!first && c >= '0' && c <= '9');
+}
+
+/* expand $NAME and ${NAME} anywhere in text; returns malloc'd string */
+char *expand_text(const char *text) {
+    size_t cap = strlen(text) + 64, len = 0;
+    char *out = malloc(cap);
+    for (const char *p = text; *p; ) {
+        char *val = NULL;
+        const char *next = NULL;
+        if (p[0] == '$' && p[1] == '{') {
+            const char *end = strchr(p + 2, '}');
+            if (end) {
+                char *name = strndup(p + 2, end - (p + 2));
+                val = get_var(name);
+                free(name);
+                next = end + 1;
+            }
+        } else if (p[0] == '$' && is_name_char(p[1], 1)) {
+            const char *q = p + 1;
+            while (is_name_char(*q, 0)) ++q;
+            char *name = strndup(p + 1, q - (p + 1));
+            val = get_var(name);
+            free(name);
+            next = q;
+        }
+        const char *piece = next ? (val ? val : "") : p;
+        size_t pl = next ? strlen(piece) : 1;
+        if (len + pl + 1 > cap) {
+            while (len + pl + 1 > cap) cap *= 2;
+            out = realloc(out, cap);
+        }
+        memcpy(out + len, piece, pl);
+        len += pl;
+        free(val);
+        p = next ? next : p + 1;
+    }
+    out[len] = '\0';
+    return out;
+}
+
+static int write_all(int fd, const char *s, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, s, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        s += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* heredoc_open_fd: return a close-on-exec descriptor positioned at the
+   start of body, or -1 on error */
+int heredoc_open_fd(const char *body) {
+    size_t len = strlen(body);
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) == 0) {
+        int cap = fcntl(p[1], F_GETPIPE_SZ);
+        if (cap >= 0 && (size_t)cap < len) cap = fcntl(p[1], F_SETPIPE_SZ, (int)len);
+        if (cap >= 0 && (size_t)cap >= len) {
+            if (write_all(p[1], body, len) == 0) {
+                close(p[1]);
+                return p[0];
+            }
+        }
+        close(p[0]);
+        close(p[1]);
+    }
+
+    int fd = memfd_create("heredoc", MFD_CLOEXEC);
+    if (fd < 0) { perror("memfd_create"); return -1; }
+    if (write_all(fd, body, len) < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+        perror("heredoc");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -1,13 +1,45 @@
 #include "shell.h"
 
-/* main: initialize readline history and start shell loop */
-int main() {
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--alloc-stats] [--stats] [--trace FILE] [--replay FILE [--repeat N]]\n", prog);
+}
+
+/* main: parse options, initialize readline history and start shell loop */
+int main(int argc, char **argv) {
+    const char *replay_file = NULL;
+    int repeat = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--alloc-stats") == 0) {
+#ifdef SHELL_ALLOC_STATS
+            alloc_stats_enable();
+#else
+            fprintf(stderr, "--alloc-stats: rebuild with 'make ALLOC_STATS=1' to enable\n");
+#endif
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (trace_open(argv[++i]) != 0) return 1;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+            if (repeat < 1) { usage(argv[0]); return 2; }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_enabled = 1;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
     /* initialize readline history support */
     using_history();
     /* enable tab completion (default readline handler) */
     rl_bind_key('\t', rl_complete);
 
+    if (replay_file && replay_load(replay_file, repeat) != 0) return 1;
+
     start_shell();
+    replay_finish();
     return 0;
 }
 
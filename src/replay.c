@@ -0,0 +1,139 @@
+/* replay.c: --replay FILE [--repeat N] load-test mode.
+   The captured command log is loaded once and handed line by line to
+   start_shell (and to if-blocks and here-documents) in place of readline,
+   so the full interactive code path runs without a terminal. At the end
+   the shell reports throughput, its own CPU versus its children's, and
+   peak RSS on stderr. */
+#include "shell.h"
+#include <sys/resource.h>
+#include <time.h>
+
+int replay_active = 0;
+
+static char **replay_lines = NULL;
+static int replay_nlines = 0;
+static int replay_repeat = 1;
+static int replay_pos = 0;
+static int replay_round = 0;
+static long replay_fed = 0;
+static struct timespec replay_start;
+static pid_t replay_owner = 0;
+static int replay_reported = 0;
+
+int replay_load(const char *path, int repeat) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+    size_t cap = 64 * 1024, len = 0, r;
+    char *text = malloc(cap);
+    while ((r = fread(text + len, 1, cap - len - 1, f)) > 0) {
+        len += r;
+        if (cap - len - 1 == 0) { cap *= 2; text = realloc(text, cap); }
+    }
+    fclose(f);
+    text[len] = '\0';
+
+    int lines_cap = 256;
+    replay_lines = malloc(sizeof(char*) * lines_cap);
+    for (char *p = text; p < text + len; ) {
+        char *nl = strchr(p, '\n');
+        char *end = nl ? nl : text + len;
+        char *q = end;
+        if (q > p && q[-1] == '\r') --q;
+        if (replay_nlines >= lines_cap) {
+            lines_cap *= 2;
+            replay_lines = realloc(replay_lines, sizeof(char*) * lines_cap);
+        }
+        replay_lines[replay_nlines++] = strndup(p, q - p);
+        p = end + 1;
+    }
+    free(text);
+
+    replay_repeat = repeat > 0 ? repeat : 1;
+    replay_owner = getpid();
+    replay_active = 1;
+    atexit(replay_at_exit);
+    clock_gettime(CLOCK_MONOTONIC, &replay_start);
+    return 0;
+}
+
+/* next line of the log as a malloc'd string (like readline), NULL at the end */
+static char *replay_next_line(void) {
+    if (replay_pos >= replay_nlines) {
+        if (++replay_round >= replay_repeat || replay_nlines == 0) return NULL;
+        replay_pos = 0;
+    }
+    replay_fed++;
+    return strdup(replay_lines[replay_pos++]);
+}
+
+/* lines already read by an if-block (here-document bodies) are handed back
+   through this queue when the block runs; while it is set, running out of
+   queued lines is end of input */
+static char **queued_lines = NULL;
+static int queued_n = 0;
+static int queued_pos = 0;
+
+void shell_queue_input(char **lines, int n) {
+    queued_lines = lines;
+    queued_n = n;
+    queued_pos = 0;
+}
+
+/* stop using the queue; returns how many queued lines were read */
+int shell_queue_end(void) {
+    int used = queued_pos;
+    queued_lines = NULL;
+    queued_n = queued_pos = 0;
+    return used;
+}
+
+/* all shell input goes through here: the if-block queue, then the replay
+   log when active, else readline */
+char *shell_readline(const char *prompt) {
+    if (queued_lines) return queued_pos < queued_n ? strdup(queued_lines[queued_pos++]) : NULL;
+    if (replay_active) return replay_next_line();
+    return readline(prompt);
+}
+
+static double tv_seconds(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void replay_report(void) {
+    if (replay_reported) return;
+    replay_reported = 1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall = (now.tv_sec - replay_start.tv_sec) + (now.tv_nsec - replay_start.tv_nsec) / 1e9;
+
+    struct rusage self, kids;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &kids);
+
+    fprintf(stderr, "[replay] %ld lines (%d x %d) in %.3f s: %.1f lines/s\n",
+            replay_fed, replay_nlines, replay_repeat, wall, wall > 0 ? replay_fed / wall : 0.0);
+    fprintf(stderr, "[replay] shell cpu: %.3f s user %.3f s sys; children cpu: %.3f s user %.3f s sys\n",
+            tv_seconds(self.ru_utime), tv_seconds(self.ru_stime),
+            tv_seconds(kids.ru_utime), tv_seconds(kids.ru_stime));
+    fprintf(stderr, "[replay] peak rss: shell %ld KiB, largest child %ld KiB\n",
+            self.ru_maxrss, kids.ru_maxrss);
+}
+
+/* normal end of replay; start_shell has already waited for the remaining
+   background jobs through the job table, so their CPU time is counted */
+void replay_finish(void) {
+    if (!replay_active) return;
+    replay_report();
+    for (int i = 0; i < replay_nlines; ++i) free(replay_lines[i]);
+    free(replay_lines);
+    replay_lines = NULL;
+    replay_nlines = 0;
+}
+
+/* 'exit' inside the log leaves through exit(); still report (forked
+   children inherit the handler, hence the owner check) */
+void replay_at_exit(void) {
+    if (!replay_active || getpid() != replay_owner) return;
+    replay_report();
+}
@@ -29,24 +29,155 @@ char *get_history_command(int n) {
 }
 
 /* ------------------------ Jobs ------------------------ */
+/* An interactive shell runs every pipeline in its own process group
+   (pgid = first stage) and hands the terminal to the foreground group, so
+   Ctrl-C and Ctrl-Z reach the whole pipeline and never the shell itself.
+   Without a terminal (or in --replay) children stay in the shell's group
+   and pgid is 0, so nothing is stopped by SIGTTIN/SIGTTOU for reading a
+   terminal it does not own. */
 static job_t jobs[JOBS_MAX];
 static int jobs_count = 0;
 
-void add_job(pid_t pid, const char *cmdline) {
+static int shell_interactive = 0;
+static int shell_terminal = STDIN_FILENO;
+static pid_t shell_pgid = 0;
+static job_t *volatile fg_job = NULL; /* job being waited on, for forwarding */
+
+/* signal a job's process group, or each live stage when it has none */
+static void signal_job(job_t *j, int sig) {
+    if (j->pgid > 0) {
+        kill(-j->pgid, sig);
+        return;
+    }
+    for (int k = 0; k < j->npids; ++k) if (j->pids[k] > 0) kill(j->pids[k], sig);
+}
+
+/* without job control nobody else signals the foreground pipeline, so
+   forward SIGINT to it; at the prompt it still ends the shell */
+static void forward_sigint(int sig) {
+    if (fg_job) {
+        signal_job(fg_job, sig);
+    } else {
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+}
+
+static void init_job_control(void) {
+    shell_interactive = isatty(shell_terminal) && !replay_active;
+    if (!shell_interactive) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = forward_sigint; /* no SA_RESTART: waitpid returns EINTR */
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+        return;
+    }
+    /* wait until we are in the foreground before taking over */
+    while (tcgetpgrp(shell_terminal) != (shell_pgid = getpgrp())) kill(-shell_pgid, SIGTTIN);
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    shell_pgid = getpid();
+    if (setpgid(shell_pgid, shell_pgid) < 0 && errno != EPERM) perror("setpgid");
+    shell_pgid = getpgrp();
+    tcsetpgrp(shell_terminal, shell_pgid);
+}
+
+/* job_control_child: called in a freshly forked child before exec. In an
+   interactive shell joins process group pgid (0 = start a new one); always
+   restores default signals. */
+void job_control_child(pid_t pgid, int foreground) {
+    if (shell_interactive) {
+        pid_t pid = getpid();
+        if (pgid == 0) pgid = pid;
+        setpgid(pid, pgid);
+        if (foreground) tcsetpgrp(shell_terminal, pgid);
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+}
+
+/* job_control_parent: parent-side twin of job_control_child, so the group
+   exists before anyone waits on or signals it. Returns the pipeline's
+   group (pid itself when pgid is 0), or 0 without job control. */
+pid_t job_control_parent(pid_t pid, pid_t pgid) {
+    if (!shell_interactive) return 0;
+    if (pgid == 0) pgid = pid;
+    setpgid(pid, pgid);
+    return pgid;
+}
+
+static job_t *find_job_by_pid(pid_t pid, int *stage) {
+    for (int i = 0; i < jobs_count; ++i)
+        for (int k = 0; k < jobs[i].npids; ++k)
+            if (jobs[i].pids[k] == pid) { if (stage) *stage = k; return &jobs[i]; }
+    return NULL;
+}
+
+/* add_job: record a pipeline by process group and stage pids; pipe_out
+   (may be NULL) marks stages writing into the next stage's pipe. Returns
+   the 1-based job number or -1 if the table is full */
+int add_job(pid_t pgid, const pid_t *pids, const unsigned char *pipe_out, int n, const char *cmdline) {
     if (jobs_count >= JOBS_MAX) {
         fprintf(stderr, "jobs list full, cannot add background job\n");
-        return;
+        return -1;
+    }
+    job_t *j = &jobs[jobs_count];
+    j->pgid = pgid;
+    j->npids = n;
+    j->pids = malloc(sizeof(pid_t) * n);
+    j->pipe_out = calloc(n, 1);
+    j->live = 0;
+    for (int k = 0; k < n; ++k) {
+        j->pids[k] = pids[k];
+        if (pipe_out) j->pipe_out[k] = pipe_out[k];
+        if (pids[k] > 0) j->live++;
     }
-    jobs[jobs_count].pid = pid;
-    jobs[jobs_count].cmdline = strdup(cmdline ? cmdline : "(background)");
-    jobs_count++;
-    printf("[bg] started pid %d: %s\n", pid, cmdline ? cmdline : "(background)");
+    j->pid = pids[n-1];
+    j->stopped = 0;
+    j->last_status = 0;
+    j->cmdline = strdup(cmdline ? cmdline : "(background)");
+    j->start_us = trace_now();
+    j->stage_us = NULL;
+    j->stage_names = NULL;
+    return ++jobs_count;
+}
+
+/* keep each stage's fork time and name so the reap path can emit its
+   fork-to-exit trace span, as wait_foreground does for foreground stages */
+static void job_trace_stages(job_t *j, cmd_t *cmds, const uint64_t *spawned_us) {
+    if (!trace_enabled) return;
+    j->stage_us = malloc(sizeof(uint64_t) * j->npids);
+    j->stage_names = malloc(sizeof(char*) * j->npids);
+    for (int k = 0; k < j->npids; ++k) {
+        j->stage_us[k] = spawned_us[k];
+        j->stage_names[k] = strdup(cmds[k].argv && cmds[k].argv[0] ? cmds[k].argv[0] : "?");
+    }
+}
+
+static void free_job(job_t *j) {
+    free(j->cmdline);
+    free(j->pids);
+    free(j->pipe_out);
+    if (j->stage_names)
+        for (int k = 0; k < j->npids; ++k) free(j->stage_names[k]);
+    free(j->stage_names);
+    free(j->stage_us);
 }
 
 void remove_job(pid_t pid) {
     for (int i = 0; i < jobs_count; ++i) {
         if (jobs[i].pid == pid) {
-            free(jobs[i].cmdline);
+            free_job(&jobs[i]);
             for (int j = i + 1; j < jobs_count; ++j) jobs[j-1] = jobs[j];
             jobs_count--;
             return;
@@ -56,30 +187,193 @@ void remove_job(pid_t pid) {
 
 void list_jobs(void) {
     for (int i = 0; i < jobs_count; ++i) {
-        printf("[%d] pid:%d  %s\n", i+1, jobs[i].pid, jobs[i].cmdline);
+        printf("[%d] pid:%d  %-8s %s\n", i+1, jobs[i].pid,
+               jobs[i].stopped ? "Stopped" : "Running", jobs[i].cmdline);
+    }
+}
+
+/* record a reaped stage. When a stage fails, nothing will read the pipe
+   feeding it again, so the stage writing into that pipe is sent SIGPIPE
+   now rather than at its next write; its own death cascades upstream.
+   Stages that exit normally are left to the kernel's SIGPIPE, and stages
+   whose stdout was redirected elsewhere are never touched. */
+static void job_stage_done(job_t *j, int stage, int status) {
+    if (j->stage_us)
+        trace_span(j->stage_names[stage], "stage", j->stage_us[stage], j->pids[stage], NULL);
+    j->pids[stage] = 0;
+    j->live--;
+    if (stage == j->npids - 1) j->last_status = status;
+    int failed = WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status) != 0);
+    if (failed && stage > 0 && j->pipe_out[stage-1] && j->pids[stage-1] > 0)
+        kill(j->pids[stage-1], SIGPIPE);
+}
+
+static void report_job_done(job_t *j) {
+    int status = j->last_status;
+    if (WIFEXITED(status)) {
+        printf("\n[bg] pid %d finished (exit %d): %s\n", j->pid, WEXITSTATUS(status), j->cmdline);
+    } else if (WIFSIGNALED(status)) {
+        printf("\n[bg] pid %d terminated by signal %d: %s\n", j->pid, WTERMSIG(status), j->cmdline);
+    } else {
+        printf("\n[bg] pid %d finished: %s\n", j->pid, j->cmdline);
+    }
+    trace_span("bg job", "job", j->start_us, j->pid, j->cmdline);
+}
+
+/* while wait_foreground runs, finished jobs stay in the table (live == 0)
+   so the job_t pointer it was given is not shifted by remove_job */
+static int defer_job_removal = 0;
+
+static void sweep_finished_jobs(void) {
+    for (int i = 0; i < jobs_count; ) {
+        if (jobs[i].live == 0) remove_job(jobs[i].pid);
+        else ++i;
+    }
+}
+
+/* apply one waitpid() result to the job table */
+static void job_table_event(pid_t pid, int status) {
+    int stage = 0;
+    job_t *j = find_job_by_pid(pid, &stage);
+    if (!j) return;
+    if (WIFSTOPPED(status)) {
+        if (!j->stopped) printf("\n[%d]+ Stopped  %s\n", (int)(j - jobs) + 1, j->cmdline);
+        j->stopped = 1;
+        return;
+    }
+    if (WIFCONTINUED(status)) {
+        j->stopped = 0;
+        return;
+    }
+    coproc_reaped(pid);
+    job_stage_done(j, stage, status);
+    if (j->live == 0) {
+        report_job_done(j);
+        if (!defer_job_removal) remove_job(j->pid);
     }
 }
 
 void reap_finished_jobs(void) {
     int status;
     pid_t pid;
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0)
+        job_table_event(pid, status);
+}
+
+/* wait_all_jobs: blocking reap_finished_jobs for the end of a replay, so
+   every job gets its finish report and trace span and its CPU time is
+   counted. Stopped jobs would never finish, so they are terminated. */
+static void wait_all_jobs(void) {
+    while (jobs_count > 0) {
         for (int i = 0; i < jobs_count; ++i) {
-            if (jobs[i].pid == pid) {
-                if (WIFEXITED(status)) {
-                    printf("\n[bg] pid %d finished (exit %d): %s\n", pid, WEXITSTATUS(status), jobs[i].cmdline);
-                } else if (WIFSIGNALED(status)) {
-                    printf("\n[bg] pid %d terminated by signal %d: %s\n", pid, WTERMSIG(status), jobs[i].cmdline);
-                } else {
-                    printf("\n[bg] pid %d finished: %s\n", pid, jobs[i].cmdline);
-                }
-                remove_job(pid);
-                break;
-            }
+            if (!jobs[i].stopped) continue;
+            signal_job(&jobs[i], SIGTERM);
+            signal_job(&jobs[i], SIGCONT);
+            jobs[i].stopped = 0;
         }
+        int status;
+        pid_t pid = waitpid(-1, &status, WUNTRACED | WCONTINUED);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        job_table_event(pid, status);
     }
 }
 
+/* wait_foreground: give j the terminal and wait until all its stages have
+   exited or it is stopped (Ctrl-Z). cmds/spawned_us, when given, name the
+   stages for tracing. Returns the last stage's wait status. */
+static int wait_foreground(job_t *j, cmd_t *cmds, const uint64_t *spawned_us) {
+    if (shell_interactive) tcsetpgrp(shell_terminal, j->pgid);
+    fg_job = j;
+    defer_job_removal = 1;
+
+    uint64_t t0 = stats_now();
+    int first = 1;
+    while (j->live > 0) {
+        int status = 0;
+        /* any child: background stages that finish meanwhile go to the job table */
+        pid_t pid = waitpid(-1, &status, WUNTRACED);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int stage = -1;
+        for (int k = 0; k < j->npids; ++k) if (j->pids[k] == pid) stage = k;
+        if (stage < 0) { job_table_event(pid, status); continue; }
+        if (WIFSTOPPED(status)) {
+            /* without job control only a real stop request counts as Ctrl-Z */
+            if (!shell_interactive && (WSTOPSIG(status) == SIGTTIN || WSTOPSIG(status) == SIGTTOU)) continue;
+            j->stopped = 1;
+            j->last_status = status;
+            break;
+        }
+        if (cmds && spawned_us)
+            trace_span(cmds[stage].argv[0] ? cmds[stage].argv[0] : "?", "stage", spawned_us[stage], pid, NULL);
+        if (first) { stats_record(STAT_WAIT, t0); t0 = stats_now(); first = 0; }
+        coproc_reaped(pid);
+        job_stage_done(j, stage, status);
+        /* an interrupted stage takes the rest of the group down with it */
+        if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT && j->live > 0) signal_job(j, SIGINT);
+    }
+    stats_record(STAT_REAP, t0);
+
+    fg_job = NULL;
+    defer_job_removal = 0;
+    if (shell_interactive) tcsetpgrp(shell_terminal, shell_pgid);
+    return j->last_status;
+}
+
+/* convert a wait status into a shell exit status */
+static int status_code(int status) {
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    if (WIFSTOPPED(status)) return 128 + WSTOPSIG(status);
+    return 0;
+}
+
+/* parse an optional job argument (%n or n); defaults to the latest job */
+static job_t *job_from_arg(const char *arg, const char *who) {
+    int n = jobs_count;
+    if (arg) n = atoi(arg[0] == '%' ? arg + 1 : arg);
+    if (n < 1 || n > jobs_count) {
+        fprintf(stderr, "%s: no such job\n", who);
+        return NULL;
+    }
+    return &jobs[n-1];
+}
+
+/* fg [%n]: continue a job in the foreground and wait for it */
+static int builtin_fg(char **argv) {
+    job_t *j = job_from_arg(argv[1], "fg");
+    if (!j) return 1;
+    printf("%s\n", j->cmdline);
+    fflush(stdout);
+    j->stopped = 0;
+    signal_job(j, SIGCONT);
+
+    int status = wait_foreground(j, NULL, NULL);
+    if (j->stopped) {
+        printf("\n[%d]+ Stopped  %s\n", (int)(j - jobs) + 1, j->cmdline);
+    } else if (j->live == 0) {
+        trace_span("bg job", "job", j->start_us, j->pid, j->cmdline);
+    }
+    /* removes this job if it finished, plus any reported meanwhile */
+    sweep_finished_jobs();
+    return status_code(status);
+}
+
+/* bg [%n]: continue a stopped job in the background */
+static int builtin_bg(char **argv) {
+    job_t *j = job_from_arg(argv[1], "bg");
+    if (!j) return 1;
+    j->stopped = 0;
+    signal_job(j, SIGCONT);
+    printf("[%d]+ %s &\n", (int)(j - jobs) + 1, j->cmdline);
+    return 0;
+}
+
 /* ------------------------ Variables (linked list) ------------------------ */
 static var_t *vars_head = NULL;
 
@@ -117,6 +411,20 @@ void set_var(const char *name, const char *value) {
     vars_head = n;
 }
 
+void unset_var(const char *name) {
+    if (!name) return;
+    for (var_t **pp = &vars_head; *pp; pp = &(*pp)->next) {
+        if (strcmp((*pp)->name, name) == 0) {
+            var_t *dead = *pp;
+            *pp = dead->next;
+            free(dead->name);
+            free(dead->value);
+            free(dead);
+            return;
+        }
+    }
+}
+
 char *get_var(const char *name) {
     if (!name) return NULL;
     var_t *cur = vars_head;
@@ -221,7 +529,7 @@ char **tokenize_whitespace(const char *s, int *out_count) {
 /* ------------------------ Parsing pipeline & redirection ------------------------ */
 /* parse_pipeline(): split on '|' into stages; each stage tokenized and detects < and >.
    Allocates cmd_t array (caller must free via free_pipeline). */
-int parse_pipeline(const char *line, cmd_t **out_cmds, int *out_n) {
+static int parse_pipeline_stages(const char *line, cmd_t **out_cmds, int *out_n) {
     if (!line) return -1;
     char *buf = strdup(line);
     if (!buf) return -1;
@@ -252,6 +560,12 @@ int parse_pipeline(const char *line, cmd_t **out_cmds, int *out_n) {
         cmds[i].argv = NULL;
         cmds[i].infile = NULL;
         cmds[i].outfile = NULL;
+        cmds[i].indup = NULL;
+        cmds[i].outdup = NULL;
+        cmds[i].here_body = NULL;
+        cmds[i].here_expand = 0;
+        cmds[i].here_delim = NULL;
+        cmds[i].here_strip_tabs = 0;
     }
 
     for (int i = 0; i < stages_n; ++i) {
@@ -271,6 +585,56 @@ int parse_pipeline(const char *line, cmd_t **out_cmds, int *out_n) {
                 if (!toks[j+1]) { free_argv(toks); free_pipeline(cmds, stages_n); free(stages); return -1; }
                 cmds[i].outfile = strdup(toks[j+1]);
                 ++j;
+            } else if (strncmp(toks[j], "<<<", 3) == 0) {
+                /* here-string: <<<word or <<< word */
+                const char *word = toks[j] + 3;
+                if (*word == '\0') {
+                    if (!toks[j+1]) { free_argv(toks); free_pipeline(cmds, stages_n); free(stages); return -1; }
+                    word = toks[++j];
+                }
+                free(cmds[i].here_body);
+                free(cmds[i].here_delim);
+                cmds[i].here_delim = NULL;
+                size_t wl = strlen(word);
+                cmds[i].here_body = malloc(wl + 2);
+                memcpy(cmds[i].here_body, word, wl);
+                cmds[i].here_body[wl] = '\n';
+                cmds[i].here_body[wl+1] = '\0';
+                cmds[i].here_expand = 1;
+            } else if (strncmp(toks[j], "<<", 2) == 0) {
+                /* here-document: <<DELIM or <<-DELIM; parse_pipeline reads the body */
+                int strip_tabs = toks[j][2] == '-';
+                const char *delim = toks[j] + 2 + strip_tabs;
+                if (*delim == '\0') {
+                    if (!toks[j+1]) { free_argv(toks); free_pipeline(cmds, stages_n); free(stages); return -1; }
+                    delim = toks[++j];
+                }
+                /* a quoted delimiter disables expansion of the body */
+                int quoted = 0;
+                size_t dl = strlen(delim);
+                char *d;
+                if (dl >= 2 && (delim[0] == '\'' || delim[0] == '"') && delim[dl-1] == delim[0]) {
+                    quoted = 1;
+                    d = strndup(delim + 1, dl - 2);
+                } else {
+                    d = strdup(delim);
+                }
+                free(cmds[i].here_body);
+                cmds[i].here_body = NULL;
+                free(cmds[i].here_delim);
+                cmds[i].here_delim = d;
+                cmds[i].here_strip_tabs = strip_tabs;
+                cmds[i].here_expand = !quoted;
+            } else if (strncmp(toks[j], "<&", 2) == 0 || strncmp(toks[j], ">&", 2) == 0) {
+                /* descriptor duplication: <&FD, >&FD or with the FD as the next word */
+                char **slot = toks[j][0] == '<' ? &cmds[i].indup : &cmds[i].outdup;
+                const char *fd = toks[j] + 2;
+                if (*fd == '\0') {
+                    if (!toks[j+1]) { free_argv(toks); free_pipeline(cmds, stages_n); free(stages); return -1; }
+                    fd = toks[++j];
+                }
+                free(*slot);
+                *slot = strdup(fd);
             } else {
                 argv[argc++] = strdup(toks[j]);
             }
@@ -286,17 +650,93 @@ int parse_pipeline(const char *line, cmd_t **out_cmds, int *out_n) {
     return 0;
 }
 
+int parse_pipeline(const char *line, cmd_t **out_cmds, int *out_n) {
+    uint64_t t0 = stats_now();
+    uint64_t tr = trace_now();
+    int rc = parse_pipeline_stages(line, out_cmds, out_n);
+    stats_record(STAT_PARSE, t0);
+    trace_span("parse_pipeline", "parse", tr, 0, line);
+    /* here-document bodies come from the following input lines; read them
+       outside the timed parse so waiting for input is not counted */
+    for (int i = 0; rc == 0 && i < *out_n; ++i) {
+        cmd_t *c = &(*out_cmds)[i];
+        if (!c->here_delim) continue;
+        c->here_body = heredoc_read_body(c->here_delim, c->here_strip_tabs);
+        free(c->here_delim);
+        c->here_delim = NULL;
+    }
+    return rc;
+}
+
 void free_pipeline(cmd_t *cmds, int n) {
     if (!cmds) return;
     for (int i = 0; i < n; ++i) {
         if (cmds[i].argv) free_argv(cmds[i].argv);
         if (cmds[i].infile) free(cmds[i].infile);
         if (cmds[i].outfile) free(cmds[i].outfile);
+        if (cmds[i].indup) free(cmds[i].indup);
+        if (cmds[i].outdup) free(cmds[i].outdup);
+        if (cmds[i].here_body) free(cmds[i].here_body);
+        if (cmds[i].here_delim) free(cmds[i].here_delim);
     }
     free(cmds);
 }
 
 /* ------------------------ Built-ins ------------------------ */
+/* descriptor number for read -u, <&FD and >&FD; -1 unless s is all digits
+   (an unset $NAME_IN expands to "" and must not mean fd 0) */
+static int parse_fd(const char *s) {
+    if (!s || !*s) return -1;
+    for (const char *p = s; *p; ++p) if (*p < '0' || *p > '9') return -1;
+    return atoi(s);
+}
+
+/* read [-u FD] NAME: read one line into NAME. Reads a byte at a time so
+   nothing past the newline is consumed from a shared fd (e.g. a coproc). */
+static int builtin_read(char **argv) {
+    int fd = STDIN_FILENO;
+    int i = 1;
+    if (argv[i] && strcmp(argv[i], "-u") == 0) {
+        if (!argv[i+1]) { fprintf(stderr, "read: -u requires a descriptor\n"); return 1; }
+        fd = parse_fd(argv[i+1]);
+        if (fd < 0) { fprintf(stderr, "read: %s: invalid file descriptor\n", argv[i+1]); return 1; }
+        i += 2;
+    }
+    if (!argv[i]) { fprintf(stderr, "read: usage: read [-u fd] name\n"); return 1; }
+
+    char buf[4096];
+    size_t len = 0;
+    int got = 0;
+    char c;
+    ssize_t r;
+    while ((r = read(fd, &c, 1)) != 0) {
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            return 1;
+        }
+        got = 1;
+        if (c == '\n') break;
+        if (len + 1 < sizeof(buf)) buf[len++] = c;
+    }
+    buf[len] = '\0';
+    set_var(argv[i], buf);
+    return got ? 0 : 1;
+}
+
+static const char *builtin_names[] = {
+    "exit", "cd", "help", "jobs", "fg", "bg", "history", "set",
+    "stats", "coproc", "read", NULL
+};
+
+/* is_builtin: true if argv[0] is handled by handle_builtin */
+static int is_builtin(char **argv) {
+    if (!argv || !argv[0]) return 0;
+    for (int i = 0; builtin_names[i]; ++i)
+        if (strcmp(argv[0], builtin_names[i]) == 0) return 1;
+    return 0;
+}
+
 int handle_builtin(char **argv) {
     if (!argv || !argv[0]) return 0;
     if (strcmp(argv[0], "exit") == 0) {
@@ -316,56 +756,78 @@ int handle_builtin(char **argv) {
         printf("  help         - show this help message\n");
         printf("  history      - show command history\n");
         printf("  !n           - execute nth command from history\n");
-        printf("  jobs         - show running background jobs (future)\n");
+        printf("  jobs         - show background and stopped jobs\n");
+        printf("  fg [%%n]      - continue job n in the foreground\n");
+        printf("  bg [%%n]      - continue stopped job n in the background\n");
 	printf("  set          - show all shell variables\n");
+	printf("  stats [on|off|-r|-j] - shell overhead latency histograms\n");
+	printf("  coproc NAME cmd - start cmd as a coprocess (fds in NAME_IN/NAME_OUT)\n");
+	printf("  coproc -c NAME  - close a coprocess's input\n");
+	printf("  read [-u fd] VAR - read a line into VAR\n");
 	return 1;
     } else if (strcmp(argv[0], "jobs") == 0) {
         list_jobs();
         return 1;
+    } else if (strcmp(argv[0], "fg") == 0) {
+        builtin_fg(argv);
+        return 1;
+    } else if (strcmp(argv[0], "bg") == 0) {
+        builtin_bg(argv);
+        return 1;
     } else if (strcmp(argv[0], "history") == 0) {
         print_history();
         return 1;
     } else if (strcmp(argv[0], "set") == 0) {
         print_vars();
         return 1;
+    } else if (strcmp(argv[0], "stats") == 0) {
+        builtin_stats(argv);
+        return 1;
+    } else if (strcmp(argv[0], "coproc") == 0) {
+        builtin_coproc(argv);
+        return 1;
+    } else if (strcmp(argv[0], "read") == 0) {
+        builtin_read(argv);
+        return 1;
     }
     return 0;
 }
 
 /* ------------------------ Variable expansion ------------------------
    For each cmd argv starting with '$', replace with value if exists, else empty string.
-   Returns 0 on success.
+   Descriptor redirections (<&$FD, >&$FD) are expanded the same way.
 */
+static void expand_word(char **slot) {
+    char *a = *slot;
+    if (!a || a[0] != '$' || strlen(a) < 2) return;
+    char *val = NULL;
+    /* ${VAR} syntax */
+    if (a[1] == '{') {
+        char *end = strchr(a+2, '}');
+        if (!end) return;
+        char *name = strndup(a+2, end - (a+2));
+        val = get_var(name);
+        free(name);
+    } else {
+        val = get_var(a + 1); // malloc'd or NULL
+    }
+    free(a);
+    *slot = val ? val : strdup(""); // empty string if undefined
+}
+
 static void expand_variables_in_cmds(cmd_t *cmds, int n) {
     for (int i = 0; i < n; ++i) {
         char **argv = cmds[i].argv;
-        if (!argv) continue;
-        for (int j = 0; argv[j]; ++j) {
-            char *a = argv[j];
-            if (a[0] == '$' && strlen(a) >= 2) {
-                const char *name = a + 1;
-                char *val = get_var(name); // malloc'd or NULL
-                free(argv[j]);
-                if (val) {
-                    argv[j] = val; // assign malloc'd string
-                } else {
-                    argv[j] = strdup(""); // empty string if undefined
-                }
-            } else {
-                /* Also support ${VAR} syntax */
-                if (a[0] == '$' && a[1] == '{') {
-                    char *end = strchr(a+2, '}');
-                    if (end) {
-                        int namelen = end - (a+2);
-                        char *name = strndup(a+2, namelen);
-                        char *val = get_var(name);
-                        free(name);
-                        free(argv[j]);
-                        if (val) argv[j] = val;
-                        else argv[j] = strdup("");
-                    }
-                }
-            }
+        if (argv) {
+            for (int j = 0; argv[j]; ++j) expand_word(&argv[j]);
+        }
+        expand_word(&cmds[i].indup);
+        expand_word(&cmds[i].outdup);
+        if (cmds[i].here_body && cmds[i].here_expand) {
+            char *body = expand_text(cmds[i].here_body);
+            free(cmds[i].here_body);
+            cmds[i].here_body = body;
+            cmds[i].here_expand = 0;
         }
     }
 }
@@ -373,17 +835,47 @@ static void expand_variables_in_cmds(cmd_t *cmds, int n) {
 /* ------------------------ Execute pipeline ------------------------ */
 /* execute_pipeline: n stages. If background==1, parent does not wait and job is recorded.
    cmdline_copy is a printable copy used for job description when background. */
-int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy) {
+static int execute_pipeline_stages(cmd_t *cmds, int n, int background, char *cmdline_copy) {
     if (!cmds || n <= 0) return -1;
 
-    /* Expand variables before execution */
+    /* Expand variables, then pathname patterns, before execution */
+    uint64_t t0 = stats_now();
     expand_variables_in_cmds(cmds, n);
+    expand_globs_in_cmds(cmds, n);
+    stats_record(STAT_EXPAND, t0);
 
     /* if single-stage and not background and builtin, run in shell */
-    if (n == 1 && !background && handle_builtin(cmds[0].argv)) {
+    if (n == 1 && !background && is_builtin(cmds[0].argv)) {
+        /* a here-document or here-string becomes the builtin's stdin for
+           the duration of the call (e.g. read VAR <<<word) */
+        int saved_stdin = -1;
+        if (cmds[0].here_body) {
+            int fd = heredoc_open_fd(cmds[0].here_body);
+            if (fd < 0) return -1;
+            saved_stdin = dup(STDIN_FILENO);
+            dup2(fd, STDIN_FILENO);
+            close(fd);
+        }
+        handle_builtin(cmds[0].argv);
+        if (saved_stdin >= 0) {
+            dup2(saved_stdin, STDIN_FILENO);
+            close(saved_stdin);
+        }
         return 0;
     }
 
+    t0 = stats_now();
+    /* here-document bodies are buffered into their fds before any fork */
+    int *here_fds = malloc(sizeof(int) * n);
+    for (int i = 0; i < n; ++i) {
+        here_fds[i] = cmds[i].here_body ? heredoc_open_fd(cmds[i].here_body) : -1;
+        if (cmds[i].here_body && here_fds[i] < 0) {
+            for (int k = 0; k < i; ++k) if (here_fds[k] >= 0) close(here_fds[k]);
+            free(here_fds);
+            return -1;
+        }
+    }
+
     int **pipes = NULL;
     if (n > 1) {
         pipes = malloc(sizeof(int*) * (n-1));
@@ -393,12 +885,22 @@ int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy) {
                 perror("pipe");
                 for (int k = 0; k <= i; ++k) if (pipes[k]) free(pipes[k]);
                 free(pipes);
+                for (int k = 0; k < n; ++k) if (here_fds[k] >= 0) close(here_fds[k]);
+                free(here_fds);
                 return -1;
             }
         }
     }
 
-    pid_t *pids = malloc(sizeof(pid_t) * n);
+    /* without a terminal stdout is fully buffered; flush so children
+       neither reorder nor re-emit the shell's pending output */
+    fflush(stdout);
+    pid_t *pids = calloc(n, sizeof(pid_t));
+    uint64_t *spawned_us = calloc(n, sizeof(uint64_t));
+    pid_t pgid = 0;
+    int forked = 0;
+    unsigned char *pipe_out = calloc(n, 1);
+    for (int i = 0; i < n-1; ++i) pipe_out[i] = !cmds[i].outfile && !cmds[i].outdup;
 
     for (int i = 0; i < n; ++i) {
         pid_t pid = fork();
@@ -407,8 +909,10 @@ int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy) {
             continue;
         } else if (pid == 0) {
             /* child */
+            job_control_child(pgid, !background);
             if (i > 0) dup2(pipes[i-1][0], STDIN_FILENO);
             if (i < n-1) dup2(pipes[i][1], STDOUT_FILENO);
+            if (here_fds[i] >= 0) dup2(here_fds[i], STDIN_FILENO);
 
             if (cmds[i].infile) {
                 int fd = open(cmds[i].infile, O_RDONLY);
@@ -422,6 +926,12 @@ int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy) {
                 dup2(fd, STDOUT_FILENO);
                 close(fd);
             }
+            if (cmds[i].indup && dup2(parse_fd(cmds[i].indup), STDIN_FILENO) < 0) {
+                fprintf(stderr, "<&%s: %s\n", cmds[i].indup, strerror(errno)); exit(1);
+            }
+            if (cmds[i].outdup && dup2(parse_fd(cmds[i].outdup), STDOUT_FILENO) < 0) {
+                fprintf(stderr, ">&%s: %s\n", cmds[i].outdup, strerror(errno)); exit(1);
+            }
 
             if (n > 1) {
                 for (int j = 0; j < n-1; ++j) {
@@ -434,7 +944,10 @@ int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy) {
             exit(1);
         } else {
             /* parent */
+            pgid = job_control_parent(pid, pgid);
             pids[i] = pid;
+            forked++;
+            spawned_us[i] = trace_now();
             if (i > 0) close(pipes[i-1][0]);
             if (i < n-1) close(pipes[i][1]);
         }
@@ -444,24 +957,90 @@ int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy) {
         for (int j = 0; j < n-1; ++j) free(pipes[j]);
         free(pipes);
     }
+    for (int i = 0; i < n; ++i) if (here_fds[i] >= 0) close(here_fds[i]);
+    free(here_fds);
+    stats_record(STAT_SPAWN, t0);
+
+    if (forked == 0) { free(pipe_out); free(spawned_us); free(pids); return -1; }
 
     if (background) {
-        add_job(pids[n-1], cmdline_copy ? cmdline_copy : "(background)");
+        const char *desc = cmdline_copy ? cmdline_copy : "(background)";
+        int jobno = add_job(pgid, pids, pipe_out, n, desc);
+        if (jobno > 0) job_trace_stages(&jobs[jobno-1], cmds, spawned_us);
+        printf("[bg] started pid %d: %s\n", pids[n-1], desc);
+        free(pipe_out);
+        free(spawned_us);
         free(pids);
         return 0;
-    } else {
-        int last_status = 0;
-        for (int i = 0; i < n; ++i) {
-            int status = 0;
-            waitpid(pids[i], &status, 0);
-            if (i == n-1) last_status = status;
+    }
+
+    job_t fg;
+    memset(&fg, 0, sizeof(fg));
+    fg.pgid = pgid;
+    fg.pids = pids;
+    fg.pipe_out = pipe_out;
+    fg.npids = n;
+    for (int i = 0; i < n; ++i) if (pids[i] > 0) fg.live++;
+    int last_status = wait_foreground(&fg, cmds, spawned_us);
+    sweep_finished_jobs();
+    if (fg.stopped) {
+        /* Ctrl-Z: keep the remaining stages as a stopped job */
+        int jobno = add_job(pgid, fg.pids, pipe_out, n, cmdline_copy ? cmdline_copy : "(foreground)");
+        if (jobno > 0) {
+            job_t *j = &jobs[jobno-1];
+            job_trace_stages(j, cmds, spawned_us);
+            j->stopped = 1;
+            j->last_status = fg.last_status;
+            printf("\n[%d]+ Stopped  %s\n", jobno, j->cmdline);
         }
-        free(pids);
-        return WEXITSTATUS(last_status);
     }
+    free(pipe_out);
+    free(spawned_us);
+    free(pids);
+    return status_code(last_status);
+}
+
+int execute_pipeline(cmd_t *cmds, int n, int background, char *cmdline_copy) {
+    uint64_t tr = trace_now();
+    int rc = execute_pipeline_stages(cmds, n, background, cmdline_copy);
+    trace_span("execute_pipeline", "exec", tr, 0, cmdline_copy);
+    return rc;
 }
 
 /* ------------------------ if-then-else handling ------------------------ */
+static void if_block_push(char ***lines, int *count, int *cap, char *line) {
+    if (*count >= *cap) { *cap *= 2; *lines = realloc(*lines, sizeof(char*) * *cap); }
+    (*lines)[(*count)++] = line;
+}
+
+/* if_block_read_bodies: store the here-document bodies that follow a
+   then/else line verbatim after it, so a body line reading 'fi', 'else' or
+   a command is not taken as part of the block. execute_lines hands them
+   back to the parser through shell_queue_input. */
+static void if_block_read_bodies(const char *line, char ***lines, int *count, int *cap) {
+    char *copy = strdup(line);
+    char *saveptr = NULL;
+    for (char *seg = strtok_r(copy, ";", &saveptr); seg; seg = strtok_r(NULL, ";", &saveptr)) {
+        cmd_t *cmds = NULL;
+        int n = 0;
+        if (parse_pipeline_stages(seg, &cmds, &n) != 0) continue;
+        for (int i = 0; i < n; ++i) {
+            if (!cmds[i].here_delim) continue;
+            char *body_line;
+            while ((body_line = shell_readline("> ")) != NULL) {
+                if_block_push(lines, count, cap, strdup(body_line));
+                char *q = body_line;
+                if (cmds[i].here_strip_tabs) while (*q == '\t') ++q;
+                int done = strcmp(q, cmds[i].here_delim) == 0;
+                free(body_line);
+                if (done) break;
+            }
+        }
+        free_pipeline(cmds, n);
+    }
+    free(copy);
+}
+
 /* read_if_block: reads lines from readline until matching 'fi'. Expects 'then' / 'else' keywords. */
 static int read_if_block(char ***then_lines, int *then_count, char ***else_lines, int *else_count) {
     *then_lines = NULL;
@@ -475,7 +1054,7 @@ static int read_if_block(char ***then_lines, int *then_count, char ***else_lines
     char mode = 'N'; /* 'N' none yet, 'T' then, 'E' else */
 
     while (1) {
-        line = readline("> ");
+        line = shell_readline("> ");
         if (!line) {
             printf("\nEOF inside if-block\n");
             break;
@@ -494,11 +1073,11 @@ static int read_if_block(char ***then_lines, int *then_count, char ***else_lines
             break;
         } else {
             if (mode == 'T') {
-                if (*then_count >= then_cap) { then_cap *= 2; *then_lines = realloc(*then_lines, sizeof(char*) * then_cap); }
-                (*then_lines)[(*then_count)++] = strdup(p);
+                if_block_push(then_lines, then_count, &then_cap, strdup(p));
+                if_block_read_bodies(p, then_lines, then_count, &then_cap);
             } else if (mode == 'E') {
-                if (*else_count >= else_cap) { else_cap *= 2; *else_lines = realloc(*else_lines, sizeof(char*) * else_cap); }
-                (*else_lines)[(*else_count)++] = strdup(p);
+                if_block_push(else_lines, else_count, &else_cap, strdup(p));
+                if_block_read_bodies(p, else_lines, else_count, &else_cap);
             } else {
                 /* ignore lines before then */
             }
@@ -511,6 +1090,8 @@ static int read_if_block(char ***then_lines, int *then_count, char ***else_lines
 /* execute_lines: run array of lines (each may be pipeline/chaining). background flag passed to execute_pipeline calls. */
 static void execute_lines(char **lines, int n, int background) {
     for (int i = 0; i < n; ++i) {
+        /* here-document bodies captured by read_if_block follow the line */
+        shell_queue_input(lines + i + 1, n - i - 1);
         /* Each line may include ; chaining, so mimic outer logic: split on ; */
         char *segment_copy = strdup(lines[i]);
         char *saveptr = NULL;
@@ -536,7 +1117,7 @@ static void execute_lines(char **lines, int n, int background) {
             if (parse_pipeline(seg, &cmds, &ncmds) == 0) {
                 char *copy = strdup(seg);
                 execute_pipeline(cmds, ncmds, background, copy);
-                if (!background) free(copy);
+                free(copy);
                 free_pipeline(cmds, ncmds);
             } else {
                 fprintf(stderr, "Parse error in then/else line: %s\n", seg);
@@ -545,6 +1126,7 @@ static void execute_lines(char **lines, int n, int background) {
             seg = strtok_r(NULL, ";", &saveptr);
         }
         free(segment_copy);
+        i += shell_queue_end();
     }
 }
 
@@ -583,15 +1165,19 @@ static int handle_if_then_else(const char *cond_text) {
 void start_shell(void) {
     char *line = NULL;
 
+    init_job_control();
+
     while (1) {
         /* Reap finished background jobs */
         reap_finished_jobs();
 
-        line = readline(PROMPT);
+        alloc_line_begin();
+        line = shell_readline(PROMPT);
         if (!line) {
-            printf("\n");
+            if (!replay_active) printf("\n");
             break;
         }
+        uint64_t line_us = trace_now();
 
         /* trim leading whitespace */
         char *p = line;
@@ -605,6 +1191,8 @@ void start_shell(void) {
         if (strncmp(p, "if ", 3) == 0) {
             handle_if_then_else(p + 3);
             free(line);
+            trace_span("line", "line", line_us, 0, history_buf[history_count-1]);
+            alloc_line_report(history_buf[history_count-1]);
             continue;
         }
 
@@ -672,7 +1260,7 @@ void start_shell(void) {
                         if (parse_pipeline(seg2, &cmds, &ncmds) == 0) {
                             char *copy = strdup(seg2);
                             execute_pipeline(cmds, ncmds, bg2, copy);
-                            if (!bg2) free(copy);
+                            free(copy);
                             free_pipeline(cmds, ncmds);
                         } else {
                             fprintf(stderr, "Parse error in history expansion: %s\n", seg2);
@@ -696,7 +1284,7 @@ void start_shell(void) {
             if (parse_pipeline(segment, &cmds, &ncmds) == 0) {
                 char *copy = strdup(segment);
                 execute_pipeline(cmds, ncmds, background, copy);
-                if (!background) free(copy);
+                free(copy); /* add_job keeps its own copy */
                 free_pipeline(cmds, ncmds);
             } else {
                 fprintf(stderr, "Parse error: %s\n", segment);
@@ -706,12 +1294,16 @@ void start_shell(void) {
         }
 
         free(line);
+        trace_span("line", "line", line_us, 0, history_buf[history_count-1]);
+        alloc_line_report(history_buf[history_count-1]);
     }
 
     /* cleanup: reap and free history/jobs and variables */
+    coproc_close_all();
+    if (replay_active) wait_all_jobs();
     reap_finished_jobs();
     for (int i = 0; i < history_count; ++i) free(history_buf[i]);
-    for (int i = 0; i < jobs_count; ++i) free(jobs[i].cmdline);
+    for (int i = 0; i < jobs_count; ++i) free_job(&jobs[i]);
     var_t *v = vars_head;
     while (v) {
         var_t *nx = v->next;
@@ -720,6 +1312,9 @@ void start_shell(void) {
         free(v);
         v = nx;
     }
+    history_count = 0;
+    jobs_count = 0;
+    vars_head = NULL;
 }
 
 
@@ -0,0 +1,102 @@
+/* stats.c: per-phase latency histograms for the shell's own overhead.
+   Each phase keeps log2-bucketed nanosecond counts, so recording is a
+   clz and an increment. When disabled, stats_now() returns 0 and
+   stats_record() returns immediately. */
+#include "shell.h"
+#include <stdint.h>
+#include <time.h>
+
+#define STAT_BUCKETS 64
+
+int stats_enabled = 0;
+
+typedef struct {
+    uint64_t buckets[STAT_BUCKETS]; /* bucket i holds samples in [2^i, 2^(i+1)) ns */
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} histogram_t;
+
+static histogram_t hists[STAT_NPHASES];
+
+static const char *phase_names[STAT_NPHASES] = {
+    "parse", "expand", "spawn", "wait", "reap"
+};
+
+uint64_t stats_now(void) {
+    if (!stats_enabled) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void stats_record(int phase, uint64_t start_ns) {
+    if (!stats_enabled || !start_ns || phase < 0 || phase >= STAT_NPHASES) return;
+    uint64_t d = stats_now() - start_ns;
+    histogram_t *h = &hists[phase];
+    int b = d ? 63 - __builtin_clzll(d) : 0;
+    h->buckets[b]++;
+    h->count++;
+    h->total_ns += d;
+    if (d > h->max_ns) h->max_ns = d;
+}
+
+void stats_reset(void) {
+    memset(hists, 0, sizeof(hists));
+}
+
+/* upper edge of the bucket holding the q-th quantile, clamped to max */
+static uint64_t percentile(const histogram_t *h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)(h->count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < STAT_BUCKETS; ++b) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            uint64_t edge = b >= 63 ? UINT64_MAX : (2ull << b) - 1;
+            return edge < h->max_ns ? edge : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+void stats_print(int json) {
+    if (json) {
+        printf("{\"enabled\":%s", stats_enabled ? "true" : "false");
+        for (int i = 0; i < STAT_NPHASES; ++i) {
+            const histogram_t *h = &hists[i];
+            printf(",\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}",
+                   phase_names[i],
+                   (unsigned long long)h->count, (unsigned long long)h->total_ns,
+                   (unsigned long long)percentile(h, 0.50),
+                   (unsigned long long)percentile(h, 0.99),
+                   (unsigned long long)h->max_ns);
+        }
+        printf("}\n");
+        return;
+    }
+    if (!stats_enabled) printf("(stats collection is off; 'stats on' to enable)\n");
+    printf("%-8s %10s %12s %12s %12s\n", "phase", "count", "p50(us)", "p99(us)", "max(us)");
+    for (int i = 0; i < STAT_NPHASES; ++i) {
+        const histogram_t *h = &hists[i];
+        printf("%-8s %10llu %12.1f %12.1f %12.1f\n", phase_names[i],
+               (unsigned long long)h->count,
+               percentile(h, 0.50) / 1000.0,
+               percentile(h, 0.99) / 1000.0,
+               h->max_ns / 1000.0);
+    }
+}
+
+/* stats [on|off|-r|-j] */
+int builtin_stats(char **argv) {
+    if (!argv[1]) { stats_print(0); return 0; }
+    if (strcmp(argv[1], "on") == 0) stats_enabled = 1;
+    else if (strcmp(argv[1], "off") == 0) stats_enabled = 0;
+    else if (strcmp(argv[1], "-r") == 0) stats_reset();
+    else if (strcmp(argv[1], "-j") == 0) stats_print(1);
+    else {
+        fprintf(stderr, "stats: usage: stats [on|off|-r|-j]\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+/* trace.c: Chrome/Perfetto trace-event export (--trace FILE).
+   Events are complete ("X") spans in JSON array format, formatted into a
+   private buffer and flushed with write(2) when it fills. Not using stdio
+   keeps forked children from flushing a copy of the parent's buffer. */
+#include "shell.h"
+#include <time.h>
+
+#define TRACE_BUFSZ (64 * 1024)
+
+int trace_enabled = 0;
+
+static int trace_fd = -1;
+static pid_t trace_owner = 0;
+static char trace_buf[TRACE_BUFSZ];
+static size_t trace_len = 0;
+static int trace_events = 0;
+
+static void trace_write_all(const char *s, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(trace_fd, s, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            perror("trace write");
+            return;
+        }
+        s += w;
+        n -= (size_t)w;
+    }
+}
+
+static void trace_flush(void) {
+    trace_write_all(trace_buf, trace_len);
+    trace_len = 0;
+}
+
+static void trace_put(const char *s, size_t n) {
+    if (trace_len + n > TRACE_BUFSZ) trace_flush();
+    if (n > TRACE_BUFSZ) { trace_write_all(s, n); return; }
+    memcpy(trace_buf + trace_len, s, n);
+    trace_len += n;
+}
+
+static void trace_puts(const char *s) {
+    trace_put(s, strlen(s));
+}
+
+/* append s as a JSON string body (without quotes) */
+static void trace_put_escaped(const char *s) {
+    char esc[8];
+    const char *run = s;
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+        trace_put(run, s - run);
+        if (c == '"' || c == '\\') snprintf(esc, sizeof(esc), "\\%c", c);
+        else snprintf(esc, sizeof(esc), "\\u%04x", c);
+        trace_puts(esc);
+        run = s + 1;
+    }
+    trace_put(run, s - run);
+}
+
+uint64_t trace_now(void) {
+    if (!trace_enabled) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+void trace_span(const char *name, const char *cat, uint64_t start_us, int tid, const char *detail) {
+    if (!trace_enabled || !start_us) return;
+    uint64_t end_us = trace_now();
+    char head[192];
+    trace_puts(trace_events++ ? ",\n{\"name\":\"" : "{\"name\":\"");
+    trace_put_escaped(name ? name : "?");
+    snprintf(head, sizeof(head),
+             "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d",
+             cat, (unsigned long long)start_us,
+             (unsigned long long)(end_us - start_us), (int)trace_owner,
+             tid ? tid : (int)trace_owner);
+    trace_puts(head);
+    if (detail) {
+        trace_puts(",\"args\":{\"cmd\":\"");
+        trace_put_escaped(detail);
+        trace_puts("\"}");
+    }
+    trace_puts("}");
+}
+
+int trace_open(const char *path) {
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (trace_fd < 0) { perror(path); return -1; }
+    trace_owner = getpid();
+    trace_enabled = 1;
+    char meta[160];
+    snprintf(meta, sizeof(meta),
+             "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"myshell\"}}",
+             (int)trace_owner);
+    trace_puts(meta);
+    trace_events = 1;
+    atexit(trace_close);
+    return 0;
+}
+
+/* flush and terminate the JSON array; runs from atexit so the 'exit'
+   builtin still produces a complete file. Children inherit the handler. */
+void trace_close(void) {
+    if (!trace_enabled || getpid() != trace_owner) return;
+    trace_puts("\n]\n");
+    trace_flush();
+    close(trace_fd);
+    trace_fd = -1;
+    trace_enabled = 0;
+}